@@ -0,0 +1,95 @@
+// Checks that `best_ai_moves` agrees with `Connect4_model::max_`.
+//
+// It doesn't need GE211; build and run it on its own:
+//
+//     c++ -std=c++14 -O2 -pthread batch_test.cxx model.cxx -o batch_test
+//     ./batch_test
+//
+// Exits with status 1 if any board's move or score differs.
+
+#include "model.hxx"
+
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+using board_t = std::vector<Connect4_model::column_t>;
+
+// Plays up to `moves` random legal moves from the empty board.
+board_t random_board(std::mt19937& rng, int moves)
+{
+    Connect4_model model;
+
+    for (int i = 0; i < moves && !model.is_game_over(); i++) {
+        int col;
+        do {
+            col = (int) (rng() % Connect4_model::m);
+        } while (!model.is_playable(col));
+
+        model.place_token(col);
+    }
+
+    std::vector<Connect4_model::column_t> board;
+    for (int col = 0; col < Connect4_model::m; col++)
+        board.push_back(model.column(col));
+
+    return board;
+}
+
+// Compares one batch against `max_`, printing any mismatches.
+int check(std::vector<board_t> const& boards, int threads)
+{
+    std::vector<mmMove_> batch = best_ai_moves(boards, threads);
+
+    if (batch.size() != boards.size()) {
+        std::cout << "wrong result count with " << threads << " threads\n";
+        return 1;
+    }
+
+    int failures = 0;
+
+    for (size_t i = 0; i < boards.size(); i++) {
+        mmMove_ expected = Connect4_model().max_(0, boards[i]);
+
+        if (batch[i].index != expected.index ||
+            batch[i].score != expected.score) {
+            std::cout << "board " << i << " with " << threads
+                      << " threads: got {" << batch[i].index << ", "
+                      << batch[i].score << "}, expected {"
+                      << expected.index << ", " << expected.score << "}\n";
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+int main()
+{
+    std::mt19937 rng(26);
+    std::vector<board_t> boards;
+
+    // Includes finished games (wins and full boards) as well as
+    // positions still in play.
+    for (int i = 0; i < 300; i++)
+        boards.push_back(random_board(rng, (int) (rng() % 43)));
+
+    int failures = 0;
+
+    failures += check(boards, 1);
+    failures += check(boards, 4);
+    failures += check({}, 0);
+
+    try {
+        best_ai_moves({board_t(Connect4_model::m - 1)});
+        std::cout << "no exception for a short board\n";
+        failures++;
+    } catch (std::invalid_argument const&) { }
+
+    if (failures) {
+        std::cout << failures << " failures\n";
+        return 1;
+    }
+
+    std::cout << "all " << boards.size() << " boards agree\n";
+}
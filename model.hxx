@@ -184,4 +184,19 @@ struct Connect4_model
     //
     //  - For either `Player p`, `winner_ == p` if and only if there is a
     //    length-`Model::k` line of `p` tokens on the board.
-};
\ No newline at end of file
+};
+
+// Finds the AI's best move in each of the given boards, as if by calling
+// `max_(0, board)` on a model holding that board, but much faster for
+// bulk analysis. Each board is converted to a pair of bitboards and
+// searched on its own; at the last level of the search, all of a node's
+// children are scored together with vectorized loops. The boards are
+// shared out among `threads` worker threads (0 means one per hardware
+// thread).
+//
+// Each board must be a valid `Connect4_model` board: `m` columns of at
+// most `n` tokens, none of them `Player::neither` (throws
+// std::invalid_argument otherwise).
+std::vector<mmMove_> best_ai_moves(
+        std::vector<std::vector<Connect4_model::column_t>> const& boards,
+        int threads = 0);